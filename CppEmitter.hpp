@@ -0,0 +1,385 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Error.hpp"
+#include "lexer.hpp"
+
+/*
+Translates a MacroCalc program into a standalone C++ source file.
+  The Emit* functions mirror MacroCalc's Parse* functions, but instead of
+  computing values they write C++ statements.  Every intermediate value is
+  stored in its own const temporary so the left-to-right evaluation order of
+  the interpreter is kept even when assignments appear inside expressions.
+  Each declared variable becomes a uniquely renamed local (name_N), which
+  turns shadowing into plain C++ block scoping.  Check() walks the grammar
+  the same way but writes nothing, so the interpreter can reject a syntax
+  error before it runs any of the program.
+*/
+
+class CppEmitter {
+private:
+  const std::vector<emplex::Token> & tokens;
+  size_t token_id = 0;
+  emplex::Token eof_token{emplex::Lexer::ID__EOF_, "", 0};
+
+  std::vector<std::unordered_map<std::string, std::string>> scopes{1};  // Name -> C++ local
+  size_t var_count = 0;
+  size_t temp_count = 0;
+
+  std::stringstream body{};
+  size_t indent = 1;
+  bool check_only = false;  // Parse only; no C++ is built
+
+  // Same nesting limit as the interpreter, so both reject the same programs.
+  size_t max_depth = 0;
+  size_t depth = 0;
+  struct DepthGuard {
+    CppEmitter & emitter;
+    DepthGuard(CppEmitter & emitter) : emitter(emitter) {
+      if (++emitter.depth > emitter.max_depth && emitter.max_depth > 0) {
+        Error(emitter.CurToken().line_id, "Nesting deeper than ", emitter.max_depth, " levels");
+      }
+    }
+    ~DepthGuard() { --emitter.depth; }
+  };
+
+  // === HELPER FUNCTIONS ===
+
+  const emplex::Token & CurToken() const {
+    return token_id < tokens.size() ? tokens[token_id] : eof_token;
+  }
+
+  const emplex::Token & UseToken() {
+    const emplex::Token & token = CurToken();
+    if (token_id < tokens.size()) token_id++;
+    return token;
+  }
+
+  const emplex::Token & UseToken(int required_id, std::string err_message = "") {
+    if (CurToken() != required_id) {
+      if (err_message.size()) Error(CurToken().line_id, err_message);
+      Error(CurToken().line_id, "Expected token type ", emplex::Lexer::TokenName(required_id),
+            ", but found ", emplex::Lexer::TokenName(CurToken()));
+    }
+    return UseToken();
+  }
+
+  bool AtEnd() const { return CurToken() == emplex::Lexer::ID__EOF_; }
+
+  void Line(const std::string & code) {
+    if (!check_only) body << std::string(indent * 2, ' ') << code << '\n';
+  }
+
+  // Store an expression in a new temporary and return the temporary's name.
+  std::string Temp(const std::string & expr) {
+    if (check_only) return "";
+    std::string name = "_t" + std::to_string(temp_count++);
+    Line("const double " + name + " = " + expr + ";");
+    return name;
+  }
+
+  std::string LookupVar(const std::string & name, size_t line) const {
+    if (check_only) return "";  // SemanticCheck has already found undefined names
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+      auto found = it->find(name);
+      if (found != it->end()) return found->second;
+    }
+    Error(line, "Undefined variable: ", name);
+    return "";
+  }
+
+  // Exact double literal, so the compiled program is bit-identical.
+  static std::string Literal(double value) {
+    std::stringstream ss;
+    ss << std::hexfloat << value;
+    return "(" + ss.str() + ")";
+  }
+
+  static std::string Escape(const std::string & text) {
+    std::string out;
+    for (char ch : text) {
+      if (ch == '\\' || ch == '"') out += '\\';
+      out += ch;
+    }
+    return out;
+  }
+
+  // === STATEMENTS ===
+
+  void EmitStatement() {
+    DepthGuard guard(*this);
+    switch (CurToken()) {
+      using namespace emplex;
+      case Lexer::ID_Print: EmitPrint(); break;
+      case Lexer::ID_Var: EmitDeclare(); break;
+      case Lexer::ID_If: EmitIf(); break;
+      case Lexer::ID_While: EmitWhile(); break;
+      case Lexer::ID_VariableName: EmitNewVal(); break;
+      case Lexer::ID_StartScope: EmitStatementBlock(); break;
+      case Lexer::ID_EOL: UseToken(); break;
+      case Lexer::ID_Endscope: Error(CurToken().line_id, "Expected a statement before '}'"); break;
+      default: Line("(void)" + EmitExpression() + ";"); break;
+    }
+  }
+
+  // Body of an if, else or while; wrapped in braces to hold its temporaries.
+  void EmitBody() {
+    if (CurToken() == emplex::Lexer::ID_Var) {
+      Error(CurToken().line_id, "Declaration must be inside a block to be translated");
+    }
+    Line("{");
+    indent++;
+    EmitStatement();
+    indent--;
+    Line("}");
+  }
+
+  void EmitStatementBlock() {
+    UseToken(emplex::Lexer::ID_StartScope);
+    Line("{");
+    indent++;
+    scopes.emplace_back();
+    while (!AtEnd() && CurToken() != emplex::Lexer::ID_Endscope) EmitStatement();
+    scopes.pop_back();
+    indent--;
+    Line("}");
+    UseToken(emplex::Lexer::ID_Endscope);
+  }
+
+  void EmitIf() {
+    UseToken(emplex::Lexer::ID_If);
+    UseToken(emplex::Lexer::ID_StartCondition);
+    std::string cond = EmitAnd();
+    UseToken(emplex::Lexer::ID_EndCondition);
+    Line("if (" + cond + " != 0)");
+    EmitBody();
+    if (CurToken() == emplex::Lexer::ID_Else) {
+      UseToken();
+      Line("else");
+      EmitBody();
+    }
+  }
+
+  void EmitWhile() {
+    UseToken(emplex::Lexer::ID_While);
+    UseToken(emplex::Lexer::ID_StartCondition);
+    Line("while (true) {");
+    indent++;
+    std::string cond = EmitAnd();
+    UseToken(emplex::Lexer::ID_EndCondition);
+    Line("if (" + cond + " == 0) break;");
+    EmitBody();
+    indent--;
+    Line("}");
+  }
+
+  void EmitPrint() {
+    UseToken(emplex::Lexer::ID_Print);
+    UseToken(emplex::Lexer::ID_StartCondition);
+    if (CurToken() == emplex::Lexer::ID_LitString) {
+      // Literal text is formatted now; only {name} values are left for run time.
+      std::string code = "std::cout";
+      std::string text = "";
+      std::string currvar = "";
+      bool in_var = false;
+      for (char ch : CurToken().lexeme) {
+        if (ch == '"') continue;
+        if (ch == '{') in_var = true;
+        else if (ch == '}') {
+          if (text.size()) code += " << \"" + Escape(text) + "\"";
+          code += " << FormatVar(" + LookupVar(currvar, CurToken().line_id) + ")";
+          text = "";
+          currvar = "";
+          in_var = false;
+        }
+        else if (in_var) currvar += ch;
+        else text += ch;
+      }
+      if (text.size()) code += " << \"" + Escape(text) + "\"";
+      UseToken(emplex::Lexer::ID_LitString);
+      Line(code + " << '\\n';");
+    }
+    else {
+      Line("std::cout << " + EmitAnd() + " << '\\n';");
+    }
+    UseToken(emplex::Lexer::ID_EndCondition);
+    UseToken(emplex::Lexer::ID_EOL);
+  }
+
+  void EmitDeclare() {
+    UseToken(emplex::Lexer::ID_Var);
+    auto var_token = UseToken(emplex::Lexer::ID_VariableName);
+    if (scopes.back().count(var_token.lexeme)) {
+      Error(var_token.line_id, "Redeclaring Variable");
+    }
+    UseToken(emplex::Lexer::ID_Equal, "left side must be variable");
+    std::string value = EmitExpression();
+    UseToken(emplex::Lexer::ID_EOL);
+    // Added after the initializer, which still sees any outer variable.
+    std::string local = var_token.lexeme + "_" + std::to_string(var_count++);
+    scopes.back()[var_token.lexeme] = local;
+    Line("[[maybe_unused]] double " + local + " = " + value + ";");
+  }
+
+  void EmitNewVal() {
+    auto var_token = UseToken(emplex::Lexer::ID_VariableName);
+    std::string local = LookupVar(var_token.lexeme, var_token.line_id);
+    UseToken(emplex::Lexer::ID_Equal, "left side must be variable");
+    Line(local + " = " + EmitExpression() + ";");
+    UseToken(emplex::Lexer::ID_EOL);
+  }
+
+  // === EXPRESSIONS (each returns the temporary holding its value) ===
+
+  std::string EmitExpression() { return EmitAddition(); }
+
+  std::string EmitAnd() {
+    std::string left = EmitEquiv();
+    if (CurToken().lexeme == "&&") {
+      UseToken();
+      std::string right = EmitEquiv();
+      return Temp("(" + left + " == 1 && " + right + " == 1) ? 1.0 : 0.0");
+    }
+    if (CurToken().lexeme == "||") {
+      UseToken();
+      std::string right = EmitEquiv();
+      return Temp("(" + left + " == 0 && " + right + " == 0) ? 0.0 : 1.0");
+    }
+    return left;
+  }
+
+  std::string EmitEquiv() {
+    DepthGuard guard(*this);
+    if (CurToken().lexeme == "!") {
+      UseToken();
+      return Temp(EmitEquiv() + " == 0 ? 1.0 : 0.0");
+    }
+    std::string left = EmitAddition();
+    const std::string & op = CurToken().lexeme;
+    if (op == "==" || op == "!=" || op == ">" || op == "<" || op == ">=" || op == "<=") {
+      std::string op_code = UseToken().lexeme;
+      std::string right = EmitAddition();
+      return Temp(left + " " + op_code + " " + right + " ? 1.0 : 0.0");
+    }
+    return left;
+  }
+
+  std::string EmitAddition() {
+    std::string left = EmitMult();
+    while (CurToken().lexeme == "+" || CurToken().lexeme == "-") {
+      const std::string & op = UseToken().lexeme;
+      std::string right = EmitMult();
+      left = Temp(left + " " + op + " " + right);
+    }
+    return left;
+  }
+
+  std::string EmitExp() {
+    DepthGuard guard(*this);
+    std::string left = EmitPrim();
+    if (CurToken().lexeme == "**") {
+      UseToken();
+      std::string right = EmitExp();
+      left = Temp("Pow(" + left + ", " + right + ")");
+    }
+    return left;
+  }
+
+  std::string EmitMult() {
+    std::string left = EmitExp();
+    while (CurToken().lexeme == "*" || CurToken().lexeme == "/" || CurToken().lexeme == "**" || CurToken().lexeme == "%") {
+      const emplex::Token & op = UseToken();
+      std::string right = EmitPrim();
+      if (op.lexeme == "*") left = Temp(left + " * " + right);
+      else if (op.lexeme == "/" || op.lexeme == "%") {
+        // Keep the run-time check, reported on the operator's source line.
+        Line("if (" + right + " == 0) DivideByZero(" + std::to_string(op.line_id) + ");");
+        if (op.lexeme == "%") return Temp("std::fmod(" + left + ", " + right + ")");
+        left = Temp(left + " / " + right);
+      }
+    }
+    return left;
+  }
+
+  std::string EmitPrim() {
+    DepthGuard guard(*this);
+    if (CurToken().lexeme == "-") {
+      UseToken();
+      return Temp("-" + EmitPrim());
+    }
+    if (CurToken() == emplex::Lexer::ID_Value) {
+      const emplex::Token & value = UseToken();
+      return check_only ? "" : Literal(std::stod(value.lexeme));
+    }
+    if (CurToken() == emplex::Lexer::ID_VariableName) {
+      const emplex::Token & var_token = UseToken();
+      std::string local = LookupVar(var_token.lexeme, var_token.line_id);
+      if (CurToken().lexeme == "=") {
+        UseToken(emplex::Lexer::ID_Equal);
+        std::string value = EmitExpression();
+        Line(local + " = " + value + ";");
+        return value;
+      }
+      return Temp(local);  // Snapshot, in case a later operand assigns to it.
+    }
+    if (CurToken() == emplex::Lexer::ID_StartCondition) {
+      UseToken(emplex::Lexer::ID_StartCondition);
+      std::string expr = EmitExpression();
+      UseToken(emplex::Lexer::ID_EndCondition);
+      return expr;
+    }
+    Error(CurToken().line_id, "Unexpected token in primary expression: ",
+          emplex::Lexer::TokenName(CurToken()));
+    return "";
+  }
+
+public:
+  CppEmitter(const std::vector<emplex::Token> & tokens, size_t max_depth = 0)
+    : tokens(tokens), max_depth(max_depth) {
+    if (tokens.size()) eof_token.line_id = tokens.back().line_id;
+  }
+
+  // Stop with an Error at the first syntax error, without translating.
+  void Check() {
+    check_only = true;
+    while (!AtEnd()) EmitStatement();
+  }
+
+  // Translate the whole program and return it as C++ source.
+  std::string Emit(const std::string & filename) {
+    while (!AtEnd()) EmitStatement();
+
+    std::stringstream out;
+    out << "// Generated by Project2 --emit-cpp from " << filename << "\n"
+        << "#include <cmath>\n"
+        << "#include <cstdlib>\n"
+        << "#include <iostream>\n"
+        << "#include <string>\n\n"
+        << "[[maybe_unused]] static void DivideByZero(size_t line) {\n"
+        << "  std::cerr << \"ERROR (line \" << line << \"): Divide by zero\" << std::endl;\n"
+        << "  exit(1);\n"
+        << "}\n\n"
+        << "// The interpreter calls pow at run time; an exponent the compiler can see\n"
+        << "// lets it substitute x * x for pow(x, 2), which can round differently.\n"
+        << "[[maybe_unused]] static double Pow(double base, double exponent) {\n"
+        << "  volatile double opaque = exponent;\n"
+        << "  return std::pow(base, opaque);\n"
+        << "}\n\n"
+        << "// Matches how the interpreter prints {name} inside a string.\n"
+        << "[[maybe_unused]] static std::string FormatVar(double value) {\n"
+        << "  std::string out = std::to_string(value);\n"
+        << "  while (out.back() == '0') out.pop_back();\n"
+        << "  if (out.back() == '.') out.pop_back();\n"
+        << "  return out;\n"
+        << "}\n\n"
+        << "int main() {\n"
+        << body.str()
+        << "  return 0;\n"
+        << "}\n";
+    return out.str();
+  }
+};
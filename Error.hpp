@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+#include "Trace.hpp"
+
+// Print an error message without stopping, so several can be reported.
+template <typename... Ts>
+void ReportError(size_t line_num, Ts... message) {
+  std::cerr << "ERROR (line " << line_num << "): ";
+  (std::cerr << ... << message);
+  std::cerr << std::endl;
+}
+
+// Thrown instead of exiting on threads that evaluate ahead of program order;
+// the work is then redone in order so the right error is the one reported.
+struct DeferredError { };
+inline thread_local bool defer_errors = false;
+
+template <typename... Ts>
+void Error(size_t line_num, Ts... message) {
+  if (defer_errors) throw DeferredError{};
+  ReportError(line_num, message...);
+  trace.Dump("error");
+  exit(1);
+}
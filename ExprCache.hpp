@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "lexer.hpp"
+
+/*
+Common subexpression elimination for parenthesized groups.
+  Every '(' ... ')' group with no assignment inside is pure, so we give it a
+  value number based on its contents; identical text gets the same number.
+  Numbers are built bottom-up: a group's key is its own tokens with each
+  nested group replaced by that group's number, so every token is looked at
+  once however deep the nesting.  Once a group is evaluated its value is kept
+  until one of the variables it reads is written, declared (shadowing) or
+  goes out of scope.
+*/
+
+class ExprCache {
+private:
+  struct Entry {
+    double value = 0.0;
+    bool valid = false;
+  };
+
+  // Each part of a key is tagged with what it refers to.
+  enum Tag : size_t { GROUP, ATOM, LEXEME, NUM_TAGS };
+
+  std::vector<size_t> expr_id;    // Value number for each '(' token (or NO_ID)
+  std::vector<size_t> group_end;  // Position of the matching ')' for each '('
+  std::vector<Entry> entries;     // Cached value for each value number
+
+  // Dependencies, stored as offset arrays: the value numbers reading atom a
+  // directly are reader_ids[reader_start[a] .. reader_start[a + 1]).
+  std::vector<size_t> reader_start, reader_ids;  // Var atom -> groups reading it directly
+  std::vector<size_t> parent_start, parent_ids;  // Value number -> groups directly containing it
+
+  std::vector<size_t> visited;    // Last Invalidate() that reached each value number
+  size_t visit_mark = 0;
+  std::vector<size_t> pending;    // Work list for Invalidate(), kept to avoid reallocating
+
+  static size_t HashKey(const size_t * key, size_t size) {
+    size_t hash = size;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ key[i]) * 0x100000001b3ull;  // FNV-1a style
+    // Multiplying only carries bits upward; fold the high bits back into the
+    // low ones the table index uses.
+    hash ^= hash >> 32;
+    hash *= 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 29);
+  }
+
+  // Turn per-item lists (given as item -> entries pairs) into an offset array.
+  static void BuildIndex(size_t num_items, const std::vector<std::pair<size_t, size_t>> & pairs,
+                         std::vector<size_t> & start, std::vector<size_t> & ids) {
+    start.assign(num_items + 1, 0);
+    for (auto [item, id] : pairs) start[item + 1]++;
+    for (size_t i = 0; i < num_items; ++i) start[i + 1] += start[i];
+    ids.resize(pairs.size());
+    std::vector<size_t> fill(start.begin(), start.end() - 1);
+    for (auto [item, id] : pairs) ids[fill[item]++] = id;
+  }
+
+public:
+  static constexpr size_t NO_ID = static_cast<size_t>(-1);
+  static constexpr size_t MIN_SPAN = 4;  // Smaller groups (in tokens) aren't worth caching
+
+  ExprCache() = default;
+
+  ExprCache(const std::vector<emplex::Token> & tokens)
+    : expr_id(tokens.size(), NO_ID), group_end(tokens.size(), NO_ID)
+  {
+    struct OpenGroup {
+      size_t start;    // Position of the '('
+      size_t key_pos;  // Where its key begins on key_stack
+      bool pure;
+    };
+    std::vector<OpenGroup> open;
+    std::vector<size_t> key_stack;      // Keys of the open groups, innermost last
+    std::unordered_map<std::string_view, size_t> lexeme_ids;  // Operators and literals
+
+    std::vector<size_t> keys;           // Key of every value number, back to back
+    std::vector<size_t> key_start{0};   // Value number -> start of its key in keys
+
+    // Open addressing hash of value numbers.  Every number comes from a '(',
+    // so at twice that many slots the table never needs to grow.
+    size_t num_groups = 0;
+    for (const emplex::Token & token : tokens) num_groups += (token == emplex::Lexer::ID_StartCondition);
+    size_t table_size = 16;
+    while (table_size < num_groups * 2) table_size *= 2;
+    std::vector<size_t> table(table_size, NO_ID);
+    const size_t mask = table_size - 1;
+
+    // Value number for a key, adding a new one if it hasn't been seen.
+    auto number = [&](const size_t * key, size_t size) {
+      size_t slot = HashKey(key, size) & mask;
+      for (; table[slot] != NO_ID; slot = (slot + 1) & mask) {
+        const size_t id = table[slot];
+        if (key_start[id + 1] - key_start[id] == size &&
+            std::equal(key, key + size, keys.data() + key_start[id])) return id;
+      }
+      table[slot] = entries.size();
+      entries.emplace_back();
+      keys.insert(keys.end(), key, key + size);
+      key_start.push_back(keys.size());
+      return table[slot];
+    };
+
+    for (size_t pos = 0; pos < tokens.size(); ++pos) {
+      const emplex::Token & token = tokens[pos];
+      if (token == emplex::Lexer::ID_StartCondition) {
+        open.push_back(OpenGroup{pos, key_stack.size(), true});
+      }
+      else if (open.empty()) continue;
+      else if (token != emplex::Lexer::ID_EndCondition) {
+        if (token == emplex::Lexer::ID_Equal) open.back().pure = false;
+        if (token == emplex::Lexer::ID_VariableName) key_stack.push_back(token.atom * NUM_TAGS + ATOM);
+        else {
+          auto [it, is_new] = lexeme_ids.try_emplace(token.lexeme, lexeme_ids.size());
+          key_stack.push_back(it->second * NUM_TAGS + LEXEME);
+        }
+      }
+      else {
+        // ')' closes the group: number it, then put the number in its parent's key.
+        const OpenGroup group = open.back();
+        open.pop_back();
+        group_end[group.start] = pos;
+        if (!group.pure) {
+          if (open.size()) open.back().pure = false;
+          key_stack.resize(group.key_pos);
+          continue;
+        }
+        const size_t id = number(key_stack.data() + group.key_pos, key_stack.size() - group.key_pos);
+        key_stack.resize(group.key_pos);
+        if (pos - group.start >= MIN_SPAN) expr_id[group.start] = id;
+        if (open.size()) key_stack.push_back(id * NUM_TAGS + GROUP);
+      }
+    }
+
+    // Who depends on what comes straight from the keys.
+    std::vector<std::pair<size_t, size_t>> reads, contains;
+    size_t num_atoms = 0;
+    for (size_t id = 0; id < entries.size(); ++id) {
+      for (size_t i = key_start[id]; i < key_start[id + 1]; ++i) {
+        const size_t target = keys[i] / NUM_TAGS;
+        if (keys[i] % NUM_TAGS == ATOM) {
+          reads.emplace_back(target, id);
+          num_atoms = std::max(num_atoms, target + 1);
+        }
+        else if (keys[i] % NUM_TAGS == GROUP) contains.emplace_back(target, id);
+      }
+    }
+    BuildIndex(num_atoms, reads, reader_start, reader_ids);
+    BuildIndex(entries.size(), contains, parent_start, parent_ids);
+    visited.resize(entries.size(), 0);
+  }
+
+  // Value number of the group starting at pos (NO_ID if not cacheable).
+  size_t GetID(size_t pos) const { return pos < expr_id.size() ? expr_id[pos] : NO_ID; }
+
+  // Position of the ')' that closes the group starting at pos.
+  size_t GetEnd(size_t pos) const { return group_end[pos]; }
+
+  bool Lookup(size_t id, double & value) const {
+    assert(id < entries.size());
+    if (!entries[id].valid) return false;
+    value = entries[id].value;
+    return true;
+  }
+
+  void Store(size_t id, double value) {
+    assert(id < entries.size());
+    entries[id] = Entry{value, true};
+  }
+
+  // A variable changed (or now resolves elsewhere); drop every group reading
+  // it, directly or through a nested group.
+  void Invalidate(size_t atom) {
+    if (atom + 1 >= reader_start.size() || reader_start[atom] == reader_start[atom + 1]) return;
+    ++visit_mark;
+    pending.assign(reader_ids.begin() + reader_start[atom], reader_ids.begin() + reader_start[atom + 1]);
+    while (pending.size()) {
+      const size_t id = pending.back();
+      pending.pop_back();
+      if (visited[id] == visit_mark) continue;
+      visited[id] = visit_mark;
+      entries[id].valid = false;
+      pending.insert(pending.end(), parent_ids.begin() + parent_start[id], parent_ids.begin() + parent_start[id + 1]);
+    }
+  }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Maps each distinct identifier to a dense integer "atom" (0, 1, 2, ...).
+  The lexer interns every variable name it sees, so the parser, SymbolTable
+  and the other passes compare and index names as plain integers.
+*/
+
+class Interner {
+private:
+  std::unordered_map<std::string, size_t> atoms{};
+  std::vector<std::string> names{};
+
+public:
+  static constexpr size_t NO_ATOM = static_cast<size_t>(-1);
+
+  // Atom for name, creating a new one the first time it is seen.
+  size_t Intern(const std::string & name) {
+    auto [it, is_new] = atoms.try_emplace(name, names.size());
+    if (is_new) names.push_back(name);
+    return it->second;
+  }
+
+  // Atom for name, or NO_ATOM if it was never interned.
+  size_t Find(const std::string & name) const {
+    auto it = atoms.find(name);
+    return it == atoms.end() ? NO_ATOM : it->second;
+  }
+
+  const std::string & GetName(size_t atom) const { return names[atom]; }
+
+  size_t size() const { return names.size(); }
+};
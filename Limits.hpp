@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+/*
+Resource limits for running untrusted programs.  A value of 0 means no limit.
+  Set on the command line as --max-steps=N, --timeout=SECONDS, --max-depth=N,
+  --max-tokens=N or --max-vars=N.
+*/
+
+struct Limits {
+  size_t max_steps = 0;     // Statements executed, checked at loop back-edges
+  double timeout = 0.0;     // Wall-clock seconds, checked at loop back-edges
+  size_t max_depth = 1000;  // Parse nesting (parens, unary ops, blocks); guards the stack
+  size_t max_tokens = 0;    // Size of the program
+  size_t max_vars = 0;      // Variables alive at once
+
+  // Apply one "--name=value" option; returns false if it isn't a known limit.
+  bool SetOption(const std::string & arg) {
+    size_t split = arg.find('=');
+    if (split == std::string::npos || split + 1 == arg.size()) return false;
+    std::string name = arg.substr(0, split);
+    std::string value = arg.substr(split + 1);
+    try {
+      if (name == "--timeout") timeout = std::stod(value);
+      else if (name == "--max-steps") max_steps = std::stoul(value);
+      else if (name == "--max-depth") max_depth = std::stoul(value);
+      else if (name == "--max-tokens") max_tokens = std::stoul(value);
+      else if (name == "--max-vars") max_vars = std::stoul(value);
+      else return false;
+    } catch (const std::exception &) {
+      return false;
+    }
+    return true;
+  }
+};
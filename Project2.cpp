@@ -1,32 +1,78 @@
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <csignal>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // Below are some suggestions on how you might want to divide up your project.
 // You may delete this and divide it up however you like.
 #include "ASTNode.hpp"
+#include "CppEmitter.hpp"
+#include "Error.hpp"
+#include "ExprCache.hpp"
+#include "Interner.hpp"
+#include "Limits.hpp"
+#include "SemanticCheck.hpp"
 #include "SymbolTable.hpp"
+#include "Trace.hpp"
 #include "lexer.hpp"
 
-template <typename... Ts>
-void Error(size_t line_num, Ts... message) {
-  std::cerr << "ERROR (line " << line_num << "): ";
-  (std::cerr << ... << message);
-  std::cerr << std::endl;
-  exit(1);
-}
-
 class MacroCalc {
  private:
+  // A print string split up front: literal text, then the variable to show after it.
+  struct PrintPart {
+    std::string text;
+    size_t atom = Interner::NO_ATOM;
+  };
+
+  // Loaded program and variables.  A parallel worker refers to its parent's
+  // copies instead of its own (see the worker constructor below).
+  std::vector<emplex::Token> own_tokens{};
+  std::vector<double> own_literals{};
+  std::vector<std::vector<PrintPart>> own_print_parts{};
+  SymbolTable own_symbols{};
+
   size_t token_id = 0;
-  std::vector<emplex::Token> tokens{};
+  const std::vector<emplex::Token> & tokens = own_tokens;
+  emplex::Token eof_token{emplex::Lexer::ID__EOF_, "", 0};  // Returned past the last token
+  const std::vector<double> & literals = own_literals;  // Value of each ID_Value token, decoded once
   //ASTNode root{ASTNode::STATEMENT_BLOCK};
 
-  SymbolTable symbols{};
+  Interner names{};  // Atoms for variable names, filled in by the lexer
+  SymbolTable & symbols = own_symbols;
+  ExprCache cse{};
+
+  const std::vector<std::vector<PrintPart>> & print_parts = own_print_parts;  // Indexed by LitString token position
+
+  // Resource limits and the counters they are checked against.
+  Limits limits{};
+  size_t steps = 0;
+  size_t back_edges = 0;
+  size_t depth = 0;
+  std::chrono::steady_clock::time_point deadline{};
+
+  // Threads for evaluating independent top-level declarations (1 runs in order).
+  size_t threads = 1;
+  static constexpr size_t MIN_PARALLEL_BATCH = 16;  // Smaller batches aren't worth the threads
+  size_t next_batch_pos = 0;  // Don't look for a new batch before this token
+
+  // Counts one level of parse recursion for as long as it is in scope.
+  struct DepthGuard {
+    MacroCalc & calc;
+    DepthGuard(MacroCalc & calc) : calc(calc) {
+      if (++calc.depth > calc.limits.max_depth && calc.limits.max_depth > 0) {
+        Error(calc.CurToken().line_id, "Nesting deeper than ", calc.limits.max_depth, " levels");
+      }
+    }
+    ~DepthGuard() { --calc.depth; }
+  };
 
   // === HELPER FUNCTIONS ===
 
@@ -37,16 +83,22 @@ class MacroCalc {
     return emplex::Lexer::TokenName(id);
   }
 
-  emplex::Token CurToken() const { return tokens[token_id]; }
+  const emplex::Token & CurToken() const {
+    return token_id < tokens.size() ? tokens[token_id] : eof_token;
+  }
 
-  emplex::Token UseToken() { return tokens[token_id++]; }
+  const emplex::Token & UseToken() {
+    const emplex::Token & token = CurToken();
+    if (token_id < tokens.size()) token_id++;
+    return token;
+  }
 
-  emplex::Token UseToken(int required_id, std::string err_message = "") {
+  const emplex::Token & UseToken(int required_id, std::string err_message = "") {
     if (CurToken() != required_id) {
       if (err_message.size())
-        Error(CurToken(), err_message);
+        Error(CurToken().line_id, err_message);
       else {
-        Error(CurToken(), "Expected token type ", TokenName(required_id),
+        Error(CurToken().line_id, "Expected token type ", TokenName(required_id),
               ", but found ", TokenName(CurToken()));
       }
     }
@@ -61,6 +113,152 @@ class MacroCalc {
     return false;
   }
 
+  // Called each time a loop jumps back; stops runaway programs.
+  void CheckBackEdge(size_t line) {
+    if (limits.max_steps && steps > limits.max_steps) {
+      Error(line, "Exceeded the limit of ", limits.max_steps, " steps");
+    }
+    // Reading the clock costs more than a loop iteration, so only sample it.
+    if (limits.timeout > 0 && (++back_edges & 255) == 0 &&
+        std::chrono::steady_clock::now() > deadline) {
+      Error(line, "Exceeded the time limit of ", limits.timeout, " seconds");
+    }
+  }
+
+  // Declare a variable in the current scope; it may shadow cached reads.
+  void DeclareVar(size_t atom) {
+    if (symbols.IsFull()) {
+      Error(CurToken().line_id, "Exceeded the limit of ", symbols.GetMaxVars(), " variables");
+    }
+    symbols.AddVar(atom);
+    cse.Invalidate(atom);
+  }
+
+  // Every write goes through here so cached subexpressions stay correct.
+  void SetVar(size_t atom, double value) {
+    trace.Write(CurToken().line_id, atom, value);
+    symbols.SetValue(atom, value);
+    cse.Invalidate(atom);
+  }
+
+  // How a {name} inside a print string is shown: no trailing zeros.
+  static std::string FormatValue(double value) {
+    std::string out = std::to_string(value);
+    while (out.back() == '0') out.pop_back();
+    if (out.back() == '.') out.pop_back();
+    return out;
+  }
+
+  // Split a print string into text and {name} parts, resolving names to atoms.
+  std::vector<PrintPart> SplitPrintString(const std::string & lexeme) {
+    std::vector<PrintPart> parts(1);
+    std::string currvar = "";
+    bool in_var = false;
+    for (char ch : lexeme) {
+      if (ch == '"') continue;
+      if (ch == '{') in_var = true;
+      else if (ch == '}') {
+        parts.back().atom = names.Intern(currvar);
+        parts.emplace_back();
+        currvar = "";
+        in_var = false;
+      }
+      else if (in_var) currvar += ch;
+      else parts.back().text += ch;
+    }
+    return parts;
+  }
+
+  // A top-level "var name = expr;" that can run on a worker thread.
+  struct BatchDecl {
+    size_t line;      // Line of the 'var', for the trace
+    size_t atom;      // Variable being declared
+    size_t expr_pos;  // First token of the initializer
+    size_t end_pos;   // Token after the ';'
+  };
+
+  // Collect the run of top-level declarations starting here whose initializers
+  // don't assign anything and don't read a variable declared earlier in the run.
+  std::vector<BatchDecl> FindBatch() const {
+    using emplex::Lexer;
+    std::vector<BatchDecl> batch;
+    std::unordered_set<size_t> written;
+    size_t pos = token_id;
+    while (pos + 3 < tokens.size() && tokens[pos] == Lexer::ID_Var &&
+           tokens[pos + 1] == Lexer::ID_VariableName && tokens[pos + 2] == Lexer::ID_Equal) {
+      const size_t atom = tokens[pos + 1].atom;
+      if (written.count(atom) || symbols.IsInMostRecentStack(atom)) break;
+      size_t end = pos + 3;
+      bool independent = true;
+      for (; end < tokens.size() && tokens[end] != Lexer::ID_EOL && independent; ++end) {
+        const emplex::Token & token = tokens[end];
+        if (token == Lexer::ID_VariableName) independent = !written.count(token.atom);
+        else if (token != Lexer::ID_Value && token != Lexer::ID_Equation &&
+                 token != Lexer::ID_StartCondition && token != Lexer::ID_EndCondition) {
+          independent = false;  // Assignments, comparisons, strings, scopes...
+        }
+      }
+      if (!independent || end == tokens.size()) break;
+      batch.push_back(BatchDecl{tokens[pos].line_id, atom, pos + 3, end + 1});
+      written.insert(atom);
+      pos = end + 1;
+    }
+    return batch;
+  }
+
+  // Evaluate a batch of independent declarations across threads, then declare
+  // them in program order.  Returns false (having changed nothing) if the batch
+  // is too small or any initializer hit an error; the caller then runs the
+  // statements in order, which reports that error exactly as before.
+  bool RunParallelBatch() {
+    if (token_id < next_batch_pos) return false;
+    std::vector<BatchDecl> batch = FindBatch();
+    // Whatever happens, these statements aren't rescanned as part of a later batch.
+    if (batch.size()) next_batch_pos = batch.back().end_pos;
+    if (batch.size() < MIN_PARALLEL_BATCH) return false;
+
+    std::vector<double> values(batch.size());
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto work = [&]() {
+      defer_errors = true;
+      MacroCalc worker(*this, WorkerTag{});
+      for (size_t i = next++; i < batch.size() && !failed; i = next++) {
+        worker.token_id = batch[i].expr_pos;
+        try {
+          values[i] = worker.ParseExpression();
+          if (worker.CurToken() != emplex::Lexer::ID_EOL) failed = true;
+        } catch (const DeferredError &) {
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < std::min(threads, batch.size()); i++) pool.emplace_back(work);
+    for (auto & thread : pool) thread.join();
+    if (failed) return false;
+
+    for (size_t i = 0; i < batch.size(); i++) {
+      token_id = batch[i].end_pos - 1;  // At the ';', as when run in order
+      steps++;
+      trace.Statement(batch[i].line, Trace::DECLARE);
+      DeclareVar(batch[i].atom);
+      SetVar(batch[i].atom, values[i]);
+    }
+    token_id = batch.back().end_pos;
+    return true;
+  }
+
+  // Worker for RunParallelBatch: shares the parent's program and (read-only)
+  // variables, with its own position, nesting depth and an empty cache.  The
+  // depth starts at 1, as inside the ParseStatement that would run the
+  // declaration in order, so both hit --max-depth at the same point.
+  struct WorkerTag { };
+  MacroCalc(const MacroCalc & parent, WorkerTag)
+    : tokens(parent.tokens), eof_token(parent.eof_token), literals(parent.literals),
+      symbols(parent.symbols), print_parts(parent.print_parts), limits(parent.limits),
+      depth(1) { ; }
+
   // ASTNode MakeVarNode(const emplex::Token& token) {
   //   size_t var_id = symbols.GetVarID(token.lexeme);
   //   assert(var_id < symbols.GetNumVars());
@@ -70,51 +268,93 @@ class MacroCalc {
   // }
 
  public:
-  MacroCalc(std::string filename) {  // Looked at WordLang.cpp for this
+  MacroCalc(std::string filename, Limits limits = {}, size_t threads = 1, bool use_cse = true)
+    : limits(limits), threads(threads) {  // Looked at WordLang.cpp for this
     std::ifstream file(filename);
     emplex::Lexer lexer;
-    tokens = lexer.Tokenize(file);
+    own_tokens = lexer.Tokenize(file);
+    names = lexer.GetInterner();
+    trace.SetNames(&names);
+
+    if (limits.max_tokens && tokens.size() > limits.max_tokens) {
+      Error(tokens[limits.max_tokens].line_id, "Program is longer than ", limits.max_tokens, " tokens");
+    }
+    if (tokens.size()) eof_token.line_id = tokens.back().line_id;
+    symbols.SetMaxVars(limits.max_vars);
+    deadline = std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(limits.timeout));
+
+    // Find every scope and declaration error, then any syntax error, before running anything.
+    if (SemanticCheck(tokens, names).Check() > 0) exit(1);
+    CppEmitter(tokens, limits.max_depth).Check();
+    if (use_cse) cse = ExprCache(tokens);
+
+    // Decode numeric literals and print strings up front so loop bodies don't redo it.
+    own_literals.resize(tokens.size());
+    own_print_parts.resize(tokens.size());
+    for (size_t pos = 0; pos < tokens.size(); ++pos) {
+      if (tokens[pos] == emplex::Lexer::ID_Value) own_literals[pos] = std::stod(tokens[pos].lexeme);
+      if (tokens[pos] == emplex::Lexer::ID_LitString) own_print_parts[pos] = SplitPrintString(tokens[pos].lexeme);
+    }
 
     Parse();
   }
   bool scope_pushed = false;
   void Parse() {
-    for(auto token : tokens)
+    while (CurToken() != emplex::Lexer::ID__EOF_)
     {
+      if (threads > 1 && RunParallelBatch()) continue;
       ParseStatement();
     }
   }
 
   void ParseStatement() {
+    DepthGuard guard(*this);
+    steps++;
+    const size_t line = CurToken().line_id;
     switch (CurToken()) {
       using namespace emplex;
       case Lexer::ID_Print:
       {
+        trace.Statement(line, Trace::PRINT);
         ParsePrint();
         break;
       }
       case Lexer::ID_Var:
       {
+        trace.Statement(line, Trace::DECLARE);
         ParseDeclare();
         break;
       }
-      case Lexer::ID_Statement: {
+      case Lexer::ID_If:
+      case Lexer::ID_While: {
+        trace.Statement(line, CurToken() == Lexer::ID_If ? Trace::IF : Trace::WHILE);
         ParseIf();
         break;
       }
       
       case Lexer::ID_VariableName: {
+        trace.Statement(line, Trace::ASSIGN);
         ParseNewVal();
         break;
       }
       // case Lexer::ID_WHILE: return ParseWhile();
       case Lexer::ID_StartScope:
       {
+        trace.Statement(line, Trace::BLOCK);
         ParseStatementBlock();
         break;
       }
       case Lexer::ID_Endscope:
       {
+        // Blocks stop before their '}', so here it is a missing if/else/while body.
+        Error(line, "Expected a statement before '}'");
+        break;
+      }
+      case Lexer::ID_EOL:
+      {
+        UseToken();  // Empty statement, e.g. a while loop with no body.
         break;
       }
 
@@ -122,6 +362,7 @@ class MacroCalc {
       //   return ASTNode{};
       default:
       {
+        trace.Statement(line, Trace::EXPRESSION);
         ParseExpression();
         break;
       }
@@ -130,99 +371,93 @@ class MacroCalc {
   void ParseStatementBlock()
   {
     UseToken(emplex::Lexer::ID_StartScope);
-    std::unordered_map<std::string, double> mp;
-    symbols.PushScope(mp);
+    symbols.PushScope();
     while(CurToken() != emplex::Lexer::ID__EOF_ and CurToken() != emplex::Lexer::ID_Endscope)
     {
       ParseStatement();
     }
     if(CurToken() == emplex::Lexer::ID__EOF_ or CurToken() == emplex::Lexer::ID_Endscope)
     {
-      symbols.PopScope();
+      for (size_t atom : symbols.PopScope()) cse.Invalidate(atom);
       UseToken(emplex::Lexer::ID_Endscope);
     }
   }
   bool while_enabled = false;
   void ParseIf(){
-    bool curr = false;
-    auto type = UseToken(emplex::Lexer::ID_Statement);
+    auto type = UseToken();  // If or While
     UseToken(emplex::Lexer::ID_StartCondition);
-    if(type.lexeme == "if"){
-      auto object = ParseExpression();
-      auto comp = UseToken(emplex::Lexer::ID_Equivalent);
-      if(comp.lexeme == "=="){
-        auto object2 = UseToken();
-        if(object == std::stod(object2.lexeme)){
-          UseToken(emplex::Lexer::ID_EndCondition);
-          ParseStatement();
-        }
-        else{
-          while(CurToken().lexeme != ";"){
-            UseToken();
-          }
-          UseToken(emplex::Lexer::ID_EOL);
+    if(type == emplex::Lexer::ID_If){
+      double cond = ParseAnd();
+      UseToken(emplex::Lexer::ID_EndCondition);
+      if (cond != 0) ParseStatement();
+      else SkipStatement();
+      if (CurToken() == emplex::Lexer::ID_Else) {
+        UseToken();
+        if (cond != 0) SkipStatement();
+        else ParseStatement();
+      }
+    }
+    else if(type == emplex::Lexer::ID_While){
+      // Re-run the condition and body by rewinding to the condition's tokens.
+      const size_t cond_pos = token_id;
+      while (true) {
+        token_id = cond_pos;
+        double cond = ParseAnd();
+        UseToken(emplex::Lexer::ID_EndCondition);
+        if (cond == 0) {
+          SkipStatement();
+          break;
         }
+        ParseStatement();
+        CheckBackEdge(type.line_id);
       }
     }
-    else if(type.lexeme == "while"){
-      //std::cout << ParseEquiv();
-      UseToken(emplex::Lexer::ID_EndCondition);
-      std::cout << CurToken().lexeme;
-      while(ParseEquiv() == 1){
+  }
+
+  // Move past the next statement without running it.
+  void SkipStatement() {
+    DepthGuard guard(*this);
+    if (CurToken() == emplex::Lexer::ID_Endscope) {
+      Error(CurToken().line_id, "Expected a statement before '}'");
+    }
+    else if (CurToken() == emplex::Lexer::ID_StartScope) {
+      size_t depth = 0;
+      do {
+        if (CurToken() == emplex::Lexer::ID_StartScope) depth++;
+        else if (CurToken() == emplex::Lexer::ID_Endscope) depth--;
+        UseToken();
+      } while (depth && CurToken() != emplex::Lexer::ID__EOF_);
+    }
+    else if (CurToken() == emplex::Lexer::ID_If || CurToken() == emplex::Lexer::ID_While) {
+      bool is_if = UseToken() == emplex::Lexer::ID_If;
+      size_t depth = 0;
+      do {
+        if (CurToken() == emplex::Lexer::ID_StartCondition) depth++;
+        else if (CurToken() == emplex::Lexer::ID_EndCondition) depth--;
+        UseToken();
+      } while (depth && CurToken() != emplex::Lexer::ID__EOF_);
+      SkipStatement();
+      if (is_if && CurToken() == emplex::Lexer::ID_Else) {
+        UseToken();
+        SkipStatement();
       }
     }
+    else {
+      while (CurToken() != emplex::Lexer::ID_EOL && CurToken() != emplex::Lexer::ID__EOF_) UseToken();
+      UseToken(emplex::Lexer::ID_EOL);
+    }
   }
 
 
-  bool isScope = false;
   void ParsePrint() {
     UseToken(emplex::Lexer::ID_Print);
     UseToken(emplex::Lexer::ID_StartCondition);
     if (CurToken().id == emplex::Lexer::ID_LitString) {
         // Handle string output with variable replacement
         std::string output = "";
-        std::string currvar = "";
-        for(auto ch : CurToken().lexeme){
-          if(ch != '"'){
-            if(ch == '{')
-            {
-              isScope = true;
-            }
-            else if(ch == '}')
-            {
-              if(!symbols.HasVar(currvar))
-              {
-                Error(CurToken(), "Variable does not exist");
-              }
-              int i = std::to_string(symbols.GetValue(currvar)).size();
-              std::string intermediate = std::to_string(symbols.GetValue(currvar));
-              std::string last_dig = "";
-              while(intermediate.back() == '0')
-              {
-                if(intermediate.back() == '0')
-                {
-                  intermediate.pop_back();
-                }
-              }
-              last_dig = intermediate.back();
-              if(last_dig == ".")
-                {
-                  intermediate.pop_back();
-                }
-              output += intermediate;
-              
-              currvar = "";
-              isScope = false;
-            }
-            else if(isScope == false)
-            {
-              output += ch;
-            }
-            else
-            {
-              currvar += ch;
-            }
-          }
+        for (const PrintPart & part : print_parts[token_id]) {
+          output += part.text;
+          if (part.atom != Interner::NO_ATOM) output += FormatValue(symbols.GetValue(part.atom));
         }
         UseToken(emplex::Lexer::ID_LitString);
         std::cout << output << std::endl;
@@ -238,23 +473,19 @@ class MacroCalc {
 
   void ParseDeclare() {
     UseToken(emplex::Lexer::ID_Var);  
-    std::string varName = CurToken().lexeme;
-    UseToken(emplex::Lexer::ID_VariableName);  
-    if(!symbols.IsInMostRecentStack(varName)){
-      symbols.AddVar(varName);
-      if(CurToken().id == emplex::Lexer::ID_Equal) {
-          UseToken(emplex::Lexer::ID_Equal);  
-          double value = ParseExpression(); 
-          symbols.SetValue(varName, value);  
-      }
-      else{
-        Error(CurToken(), "left side must be variable");
-      }
-      UseToken(emplex::Lexer::ID_EOL);
+    size_t var = UseToken(emplex::Lexer::ID_VariableName).atom;  
+    if(symbols.IsInMostRecentStack(var)){
+      Error(CurToken().line_id, "Redeclaring Variable");
     }
-    else{
-      Error(CurToken(), "Redeclaring Variable");
+    if(CurToken().id != emplex::Lexer::ID_Equal) {
+      Error(CurToken().line_id, "left side must be variable");
     }
+    UseToken(emplex::Lexer::ID_Equal);  
+    // The initializer runs first, so it still sees any variable being shadowed.
+    double value = ParseExpression(); 
+    DeclareVar(var);
+    SetVar(var, value);  
+    UseToken(emplex::Lexer::ID_EOL);
   }
 
   double ParseExpression() {
@@ -279,6 +510,7 @@ class MacroCalc {
   }
   
   double ParseEquiv() {
+    DepthGuard guard(*this);
     if(CurToken().lexeme == "!"){
       UseToken(); 
       double right = ParseEquiv(); 
@@ -319,25 +551,18 @@ class MacroCalc {
 
   void ParseNewVal()
   {
-    std::string varName = CurToken().lexeme;
-    UseToken(emplex::Lexer::ID_VariableName);  
-    if(symbols.HasVar(varName))
-    {
-      if(CurToken().id == emplex::Lexer::ID_Equal) {
-          UseToken(emplex::Lexer::ID_Equal);  
-          double value = ParseExpression(); 
-          symbols.SetValue(varName, value); 
-          
-      }
-      else
-      {
-        Error(CurToken(), "left side must be variable");
-      }
-      UseToken(emplex::Lexer::ID_EOL);
+    size_t var = UseToken(emplex::Lexer::ID_VariableName).atom;  
+    // SemanticCheck already made sure var is declared.
+    if(CurToken().id == emplex::Lexer::ID_Equal) {
+        UseToken(emplex::Lexer::ID_Equal);  
+        double value = ParseExpression(); 
+        SetVar(var, value); 
     }
-    else{
-      Error(CurToken(), "Redeclaring Variable");
+    else
+    {
+      Error(CurToken().line_id, "left side must be variable");
     }
+    UseToken(emplex::Lexer::ID_EOL);
   }
     // Parse additive expressions (e.g., addition and subtraction)
   double ParseAddition() {
@@ -356,6 +581,7 @@ class MacroCalc {
   }
 
   double ParseExp(){
+    DepthGuard guard(*this);  // '**' recurses to the right
     double left = ParsePrim();
     if(CurToken().lexeme == "**"){
       UseToken();
@@ -369,6 +595,7 @@ class MacroCalc {
     double left = ParseExp();
     while (CurToken().lexeme == "*" or CurToken().lexeme == "/" or CurToken().lexeme == "**" or CurToken().lexeme == "%") {
       auto op = CurToken().lexeme;
+      const size_t op_line = CurToken().line_id;
       UseToken(CurToken().id);  // Consume '*', '/', or '**'
       double right = ParsePrim();
       if (op == "*") {
@@ -376,13 +603,13 @@ class MacroCalc {
       } 
       else if (op == "/") {
         if (right == 0) {
-            Error(CurToken(),"Divide by zero");
+            Error(op_line, "Divide by zero");
         }
         left /= right;
       } 
       else if (op == "%") {
         if (right == 0) {
-          Error(CurToken(),"Divide by zero");
+          Error(op_line, "Divide by zero");
         }
         return fmod(left, right);
       } 
@@ -391,49 +618,109 @@ class MacroCalc {
   }
   // Parse primary expressions (e.g., numbers, variables, or parenthesized expressions)
   double ParsePrim() {
+    DepthGuard guard(*this);
     if (CurToken().lexeme == "-") {
         UseToken();  // Consume the '-'
         return -ParsePrim();  // Negate the next primary expression
     }
     if (CurToken().id == emplex::Lexer::ID_Value) {
-      double value = std::stod(CurToken().lexeme);  // Convert token to double
+      double value = literals[token_id];  // Decoded when the file was loaded
       UseToken(emplex::Lexer::ID_Value);  // Consume the numeric value token
       return value;
     } 
     else if (CurToken().id == emplex::Lexer::ID_VariableName) {
-      std::string varName = CurToken().lexeme;
-      UseToken(emplex::Lexer::ID_VariableName);
-      if (CurToken().lexeme == "=") {
+      size_t var = UseToken(emplex::Lexer::ID_VariableName).atom;
+      if (CurToken() == emplex::Lexer::ID_Equal) {
         UseToken(emplex::Lexer::ID_Equal);  // Consume the '='
         double value = ParseExpression();  
-        symbols.SetValue(varName, value);  
+        SetVar(var, value);  
         return value; 
       }
-      if (!symbols.HasVar(varName)) {
-        Error(token_id, "Undefined variable: ", varName);
-      }
-      return symbols.GetValue(varName);  // Return the value of the variable
+      return symbols.GetValue(var);  // Declared; checked by SemanticCheck
     } 
     else if (CurToken().id == emplex::Lexer::ID_StartCondition) {
+      // Reuse the value of an identical pure group if none of its inputs changed.
+      size_t expr_id = cse.GetID(token_id);
+      double expr;
+      if (expr_id != ExprCache::NO_ID && cse.Lookup(expr_id, expr)) {
+        token_id = cse.GetEnd(token_id) + 1;
+        return expr;
+      }
       UseToken(emplex::Lexer::ID_StartCondition);
-      double expr = ParseExpression();  // Parse expression inside parentheses
+      expr = ParseExpression();  // Parse expression inside parentheses
       UseToken(emplex::Lexer::ID_EndCondition);  // Expect closing parenthesis
+      if (expr_id != ExprCache::NO_ID) cse.Store(expr_id, expr);
       return expr;
     }
-    else if(CurToken().id != emplex::Lexer::ID__EOF_){
-      Error(token_id, "Unexpected token in primary expression: ", TokenName(CurToken().id));
-    }
+    Error(CurToken().line_id, "Unexpected token in primary expression: ", TokenName(CurToken().id));
+    return 0.0;
   }
 };
 
+// Show the recent statements when a signal stops the program.  SIGUSR1 just
+// shows them and lets a long-running program continue.
+static void DumpTraceOnSignal(int signal_id) {
+  switch (signal_id) {
+    case SIGUSR1: trace.Dump("SIGUSR1"); return;
+    case SIGINT: trace.Dump("SIGINT"); break;
+    case SIGTERM: trace.Dump("SIGTERM"); break;
+    case SIGSEGV: trace.Dump("SIGSEGV"); break;
+    case SIGBUS: trace.Dump("SIGBUS"); break;
+    case SIGFPE: trace.Dump("SIGFPE"); break;
+    case SIGABRT: trace.Dump("SIGABRT"); break;
+  }
+  raise(signal_id);  // The handler was reset, so this ends the program as usual.
+}
+
+static void InstallTraceHandlers() {
+  // Own stack, so a stack overflow can still be reported.
+  static char signal_stack[1 << 16];
+  stack_t stack{};
+  stack.ss_sp = signal_stack;
+  stack.ss_size = sizeof(signal_stack);
+  sigaltstack(&stack, nullptr);
+
+  struct sigaction action{};
+  action.sa_handler = DumpTraceOnSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_ONSTACK;
+  sigaction(SIGUSR1, &action, nullptr);
+  action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+  for (int signal_id : {SIGINT, SIGTERM, SIGSEGV, SIGBUS, SIGFPE, SIGABRT}) {
+    sigaction(signal_id, &action, nullptr);
+  }
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cout << "Format: " << argv[0] << " [filename]" << std::endl;
+  bool emit_cpp = false;
+  bool use_cse = true;
+  size_t threads = 1;
+  Limits limits;
+  std::string filename = "";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--emit-cpp") emit_cpp = true;
+    else if (arg == "--no-cse") use_cse = false;
+    else if (arg.starts_with("--trace=") && arg.size() > 8) trace.SetPath(argv[i] + 8);
+    else if (arg == "--parallel") threads = std::max(2u, std::thread::hardware_concurrency());
+    else if (arg.starts_with("--parallel=") && arg.size() > 11 &&
+             arg.find_first_not_of("0123456789", 11) == std::string::npos) {
+      threads = std::stoul(arg.substr(11));
+    }
+    else if (arg.starts_with("--")) {
+      if (!limits.SetOption(arg)) {
+        filename = "";  // Unknown option; show the usage message.
+        break;
+      }
+    }
+    else filename = arg;
+  }
+  if (filename == "") {
+    std::cout << "Format: " << argv[0] << " [--emit-cpp] [--no-cse] [--trace=FILE] [--parallel[=THREADS]] [--max-steps=N] [--timeout=SECONDS]"
+              << " [--max-depth=N] [--max-tokens=N] [--max-vars=N] [filename]" << std::endl;
     exit(1);
   }
 
-  std::string filename = argv[1];
-
   std::ifstream in_file(filename);  // Load the input file
   if (in_file.fail()) {
     std::cout << "ERROR: Unable to open file '" << filename << "'."
@@ -441,10 +728,19 @@ int main(int argc, char* argv[]) {
     exit(1);
   }
 
+  // With --emit-cpp, translate to standalone C++ on stdout instead of running.
+  if (emit_cpp) {
+    emplex::Lexer lexer;
+    std::vector<emplex::Token> tokens = lexer.Tokenize(in_file);
+    if (SemanticCheck(tokens, lexer.GetInterner()).Check() > 0) exit(1);
+    std::cout << CppEmitter(tokens, limits.max_depth).Emit(filename);
+    return 0;
+  }
+
   // TO DO:
   // PARSE input file to create Abstract Syntax Tree (AST).
   // EXECUTE the AST to run your program.
 
-  MacroCalc calc(filename);
+  InstallTraceHandlers();
+  MacroCalc calc(filename, limits, threads, use_cse);
 }
-
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Error.hpp"
+#include "Interner.hpp"
+#include "lexer.hpp"
+
+/*
+Scope and declaration checks, run over the tokens before anything executes.
+  Every problem is reported (with its source line) instead of stopping at the
+  first, and a program that passes can skip name checks while it runs.
+  A declaration becomes visible after its ';'.  A declaration can't be the
+  whole body of an if, else or while (it would land in the enclosing scope,
+  maybe more than once); it must be inside a '{ }' block.
+*/
+
+class SemanticCheck {
+private:
+  const std::vector<emplex::Token> & tokens;
+  const Interner & names;
+  std::vector<std::vector<size_t>> declared;  // Atom -> scope depth of each visible declaration
+  std::vector<std::vector<size_t>> scopes{1}; // Atoms declared in each open scope
+  size_t error_count = 0;
+
+  template <typename... Ts>
+  void Report(size_t line_num, Ts... message) {
+    ReportError(line_num, message...);
+    error_count++;
+  }
+
+  bool IsVisible(size_t atom) const {
+    return atom < declared.size() && declared[atom].size();
+  }
+
+  bool InCurrentScope(size_t atom) const {
+    return IsVisible(atom) && declared[atom].back() == scopes.size() - 1;
+  }
+
+  void Declare(size_t atom) {
+    if (atom >= declared.size()) declared.resize(atom + 1);
+    declared[atom].push_back(scopes.size() - 1);
+    scopes.back().push_back(atom);
+  }
+
+  void PopScope() {
+    for (size_t atom : scopes.back()) declared[atom].pop_back();
+    scopes.pop_back();
+  }
+
+  // Check every {name} inside a print string.
+  void CheckString(const emplex::Token & token) {
+    std::string currvar = "";
+    bool in_var = false;
+    for (char ch : token.lexeme) {
+      if (ch == '"') continue;
+      if (ch == '{') in_var = true;
+      else if (ch == '}') {
+        if (!IsVisible(names.Find(currvar))) Report(token.line_id, "Variable does not exist: ", currvar);
+        currvar = "";
+        in_var = false;
+      }
+      else if (in_var) currvar += ch;
+    }
+    if (in_var) Report(token.line_id, "Missing '}' after variable name in string");
+  }
+
+  // Position just past the ')' matching the '(' at pos.
+  size_t SkipCondition(size_t pos) const {
+    size_t depth = 0;
+    for (; pos < tokens.size(); ++pos) {
+      if (tokens[pos] == emplex::Lexer::ID_StartCondition) depth++;
+      else if (tokens[pos] == emplex::Lexer::ID_EndCondition && --depth == 0) return pos + 1;
+    }
+    return pos;
+  }
+
+public:
+  SemanticCheck(const std::vector<emplex::Token> & tokens, const Interner & names)
+    : tokens(tokens), names(names) { ; }
+
+  // Report all scope and declaration errors; returns how many were found.
+  size_t Check() {
+    size_t body_pos = static_cast<size_t>(-1);  // Start of the latest if/else/while body
+    size_t pending_var = Interner::NO_ATOM;      // Declared atom, visible at the next ';'
+
+    for (size_t pos = 0; pos < tokens.size(); ++pos) {
+      const emplex::Token & token = tokens[pos];
+      switch (token) {
+        using namespace emplex;
+        case Lexer::ID_StartScope:
+          scopes.emplace_back();
+          break;
+        case Lexer::ID_Endscope:
+          if (scopes.size() == 1) Report(token.line_id, "Unexpected '}' with no open scope");
+          else PopScope();
+          break;
+        case Lexer::ID_If:
+        case Lexer::ID_While:
+          body_pos = SkipCondition(pos + 1);
+          break;
+        case Lexer::ID_Else:
+          body_pos = pos + 1;
+          break;
+        case Lexer::ID_Var: {
+          if (pos == body_pos) {
+            Report(token.line_id, "Declaration as the body of if, else or while must be inside a block");
+          }
+          if (pos + 1 >= tokens.size() || tokens[pos + 1] != Lexer::ID_VariableName) {
+            Report(token.line_id, "Expected a variable name after 'var'");
+            break;
+          }
+          const emplex::Token & name = tokens[++pos];
+          if (pos + 1 >= tokens.size() || tokens[pos + 1] != Lexer::ID_Equal) {
+            Report(name.line_id, "left side must be variable");
+          }
+          if (InCurrentScope(name.atom)) {
+            Report(name.line_id, "Redeclaring Variable: ", name.lexeme);
+          }
+          else pending_var = name.atom;
+          break;
+        }
+        case Lexer::ID_EOL:
+          if (pending_var != Interner::NO_ATOM) Declare(pending_var);
+          pending_var = Interner::NO_ATOM;
+          break;
+        case Lexer::ID_VariableName:
+          if (!IsVisible(token.atom)) Report(token.line_id, "Undefined variable: ", token.lexeme);
+          break;
+        case Lexer::ID_LitString:
+          CheckString(token);
+          break;
+      }
+    }
+
+    if (scopes.size() > 1) {
+      Report(tokens.back().line_id, "Expected token type Endscope, but found _EOF_");
+    }
+    return error_count;
+  }
+};
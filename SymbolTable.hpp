@@ -8,87 +8,68 @@
 /*
 Needs two things: Name lookup and VarInfo
 VarInfo:
-  Keep a vector of variables - Vector<VarInfo> var_info
-  Similar to how things were written in his SymbolTable
   Value of a variable is just a double
 NameLookup:
-  Use name to find variable value
+  Every name is an atom from the Interner, so lookup is an index, not a search.
+  Each atom keeps a stack of its bindings; the top one is the visible variable.
 
 Changing Scope:
-  When you hit an open brace, increment scope
-  When you hit a close brace, decrement scope
+  When you hit an open brace, push a scope
+  When you hit a close brace, pop the binding of every atom declared in it
 */
 
 class SymbolTable {
 private:
-  struct VarData{
-    std::string name;
-    size_t line_num;
+  struct Binding {
+    double value;
+    size_t depth;  // Scope the variable was declared in
   };
   // CODE TO STORE SCOPES AND VARIABLES HERE.
-  
-  // HINT: YOU CAN CONVERT EACH VARIABLE NAME TO A UNIQUE ID TO CLEANLY DEAL
-  //       WITH SHADOWING AND LOOKING UP VARIABLES LATER.
-  std::vector<VarData> var_info;
-  std::vector<std::unordered_map<std::string, double>> scope{1};
+  std::vector<std::vector<Binding>> bindings;  // Atom -> shadowed bindings, innermost last
+  std::vector<std::vector<size_t>> scope{1};   // Atoms declared in each open scope
+  size_t num_vars = 0;  // Variables alive across all scopes
+  size_t max_vars = 0;  // Cap on num_vars (0 for none)
 
 public:
   // CONSTRUCTOR, ETC HERE
   SymbolTable(){} 
   static constexpr size_t NO_ID = static_cast<size_t>(-1);
   // FUNCTIONS TO MANAGE SCOPES
-  void PushScope(std::unordered_map<std::string, double> mp) { scope.push_back(mp); }
-  std::unordered_map<std::string, double> PopScope()
+  void PushScope() { scope.emplace_back(); }
+  // Close the innermost scope; returns the atoms that were declared in it.
+  std::vector<size_t> PopScope()
   { 
-    auto temp = scope.back(); 
+    auto temp = std::move(scope.back()); 
     scope.pop_back(); 
+    for (size_t atom : temp) bindings[atom].pop_back();
+    num_vars -= temp.size();
     return temp;
   }
+  // LIMIT ON LIVE VARIABLES
+  void SetMaxVars(size_t max) { max_vars = max; }
+  size_t GetMaxVars() const { return max_vars; }
+  size_t GetNumVars() const { return num_vars; }
+  bool IsFull() const { return max_vars && num_vars >= max_vars; }
   // FUNCTIONS TO MANAGE VARIABLES
-  bool HasVar(std::string var_name) const {
-    for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
-      if (it->find(var_name) != it->end()) {
-        return true;
-      }
-    }
-    return false;
+  bool HasVar(size_t atom) const {
+    return atom < bindings.size() && bindings[atom].size();
   }
-  size_t AddVar(std::string name) { 
-    auto &curr_scope = scope.back();
-    if (curr_scope.count(name)) {
-      std::cerr << "ERROR"<< ": Redeclaring variable '" << name << "'." << std::endl;
-    }
-    size_t var_id = var_info.size();
-    var_info.emplace_back(VarData {name});
-    curr_scope[name] = var_id;
-    return var_id;
+  void AddVar(size_t atom) { 
+    assert(!IsInMostRecentStack(atom));
+    if (atom >= bindings.size()) bindings.resize(atom + 1);
+    bindings[atom].push_back(Binding{0.0, scope.size() - 1});
+    scope.back().push_back(atom);
+    num_vars++;
   }
-  double GetValue(std::string var_name) const {
-    for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
-      if (it->find(var_name) != it->end()) {
-        return it->at(var_name);
-      }
-    }
-    return 0;
+  double GetValue(size_t atom) const {
+    assert(HasVar(atom));
+    return bindings[atom].back().value;
   }
-  void SetValue(const std::string& var_name, double value) {
-    for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
-      if (it->find(var_name) != it->end()) {
-        (*it)[var_name] = value;
-        return;
-      }
-    }
+  void SetValue(size_t atom, double value) {
+    if (HasVar(atom)) bindings[atom].back().value = value;
   }
-  bool IsInMostRecentStack(std::string name)
+  bool IsInMostRecentStack(size_t atom) const
   {
-    for(auto it : scope.back())
-    {
-      if(it.first == name)
-      {
-        return true;
-      }
-    }
-    return false;
+    return HasVar(atom) && bindings[atom].back().depth == scope.size() - 1;
   }
 };
-
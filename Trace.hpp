@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Interner.hpp"
+
+/*
+A fixed-size ring of the most recent statements run and the variables they
+  wrote, kept for post-mortem debugging.  Recording is a few plain stores, so
+  it is always on; Dump() prints it when an Error stops the program or a
+  signal arrives.  Only the main thread records (parallel workers never
+  write variables), and Dump() only uses write(2), so it is safe to call
+  from a signal handler.
+*/
+
+class Trace {
+public:
+  enum Kind : uint32_t { PRINT, DECLARE, ASSIGN, IF, WHILE, BLOCK, EXPRESSION, WRITE };
+
+private:
+  struct Record {
+    uint32_t line;
+    Kind kind;
+    size_t atom;   // Variable written (WRITE only)
+    double value;  // Value written (WRITE only)
+  };
+
+  static constexpr size_t SIZE = 128;  // Power of two, so the index is a mask
+  Record records[SIZE]{};
+  std::atomic<size_t> count{0};  // Total ever recorded; only the main thread stores it
+
+  const Interner * names = nullptr;  // For showing variable names
+  const char * path = nullptr;       // Dump to this file instead of stderr
+
+  // Async-signal-safe text output into a fixed buffer.
+  struct Writer {
+    char buffer[256];
+    size_t size = 0;
+
+    void Add(char ch) { if (size < sizeof(buffer)) buffer[size++] = ch; }
+    void Add(const char * text) { while (*text) Add(*text++); }
+    void Add(const std::string & text) { for (char ch : text) Add(ch); }
+
+    void AddUnsigned(uint64_t value) {
+      char digits[20];
+      size_t n = 0;
+      do { digits[n++] = static_cast<char>('0' + value % 10); value /= 10; } while (value);
+      while (n) Add(digits[--n]);
+    }
+
+    // Up to six decimal places with trailing zeros dropped, like FormatValue.
+    void AddDouble(double value) {
+      if (std::isnan(value)) return Add("nan");
+      if (value < 0) { Add('-'); value = -value; }
+      if (std::isinf(value)) return Add("inf");
+      int exponent = 0;
+      while (value >= 1e18) { value /= 10; exponent++; }
+      uint64_t whole = static_cast<uint64_t>(value);
+      uint64_t frac = static_cast<uint64_t>((value - static_cast<double>(whole)) * 1e6 + 0.5);
+      if (frac == 1000000) { whole++; frac = 0; }
+      AddUnsigned(whole);
+      if (frac) {
+        Add('.');
+        char digits[6];
+        for (int i = 5; i >= 0; --i) { digits[i] = static_cast<char>('0' + frac % 10); frac /= 10; }
+        int last = 5;
+        while (digits[last] == '0') last--;
+        for (int i = 0; i <= last; ++i) Add(digits[i]);
+      }
+      if (exponent) { Add('e'); AddUnsigned(static_cast<uint64_t>(exponent)); }
+    }
+
+    void Flush(int fd) {
+      for (size_t done = 0; done < size; ) {
+        ssize_t wrote = write(fd, buffer + done, size - done);
+        if (wrote <= 0) break;
+        done += static_cast<size_t>(wrote);
+      }
+      size = 0;
+    }
+  };
+
+  static const char * KindName(Kind kind) {
+    switch (kind) {
+      case PRINT: return "print";
+      case DECLARE: return "var";
+      case ASSIGN: return "assign";
+      case IF: return "if";
+      case WHILE: return "while";
+      case BLOCK: return "block";
+      case EXPRESSION: return "expression";
+      case WRITE: return "write";
+    }
+    return "?";
+  }
+
+  void Add(size_t line, Kind kind, size_t atom, double value) {
+    const size_t next = count.load(std::memory_order_relaxed);
+    records[next & (SIZE - 1)] = Record{static_cast<uint32_t>(line), kind, atom, value};
+    // A signal handler on this thread must see the record before the new count.
+    std::atomic_signal_fence(std::memory_order_release);
+    count.store(next + 1, std::memory_order_relaxed);
+  }
+
+public:
+  void SetNames(const Interner * in_names) { names = in_names; }
+  void SetPath(const char * in_path) { path = in_path; }
+
+  // A statement is about to run.
+  void Statement(size_t line, Kind kind) { Add(line, kind, Interner::NO_ATOM, 0.0); }
+
+  // A variable was given a value.
+  void Write(size_t line, size_t atom, double value) { Add(line, WRITE, atom, value); }
+
+  // Print the recorded statements, oldest first.  Does nothing if none were run.
+  void Dump(const char * reason) const {
+    const size_t end = count.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    if (end == 0) return;
+
+    int fd = 2;
+    if (path) fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+
+    Writer out;
+    const size_t start = end > SIZE ? end - SIZE : 0;
+    out.Add("TRACE (");
+    out.Add(reason);
+    out.Add("): last ");
+    out.AddUnsigned(end - start);
+    out.Add(" of ");
+    out.AddUnsigned(end);
+    out.Add(" events, oldest first\n");
+    out.Flush(fd);
+    for (size_t i = start; i < end; ++i) {
+      const Record & record = records[i & (SIZE - 1)];
+      out.Add("  line ");
+      out.AddUnsigned(record.line);
+      out.Add(": ");
+      if (record.kind == WRITE) {
+        out.Add("  ");
+        if (names && record.atom < names->size()) out.Add(names->GetName(record.atom));
+        else { out.Add('#'); out.AddUnsigned(record.atom); }
+        out.Add(" = ");
+        out.AddDouble(record.value);
+      }
+      else out.Add(KindName(record.kind));
+      out.Add('\n');
+      out.Flush(fd);
+    }
+    if (path) close(fd);
+  }
+};
+
+// The one trace for this process, so Error and signal handlers can reach it.
+inline Trace trace{};
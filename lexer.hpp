@@ -8,12 +8,15 @@
 #include <unordered_map>
 #include <vector>
 
+#include "Interner.hpp"
+
 namespace emplex {
   // Struct to store information about a found Token
   struct Token {
     int id;                             // Type ID for token
     std::string lexeme;                 // Sequence matched by token
     size_t line_id;                     // Line token started on
+    size_t atom = Interner::NO_ATOM;    // Interned name, for ID_VariableName tokens
     operator int() const { return id; } // Auto-convert tokens to IDs
   };
   
@@ -115,7 +118,7 @@ namespace emplex {
   
   class Lexer {
   private:
-    static constexpr int NUM_TOKENS=17;
+    static constexpr int NUM_TOKENS=19;
     static constexpr int ERROR_ID = -1;     ///< Code for unknown token ID.
   
     // -- Current State --
@@ -123,6 +126,7 @@ namespace emplex {
     int start_pos = 0;     // Track INDEX for the start of current lexeme.
     std::string lexeme{};  // Lexeme found for the current token
     std::string errors{};  // Description of any errors encountered
+    Interner interner{};   // Atoms for every variable name seen
   
   public:
     static constexpr int ID__EOF_ = 0;
@@ -142,7 +146,9 @@ namespace emplex {
     static constexpr int ID_Print = 252;            // Regex: print
     static constexpr int ID_Endscope = 253;         // Regex: }
     static constexpr int ID_StartScope = 254;       // Regex: {
-    static constexpr int ID_Statement = 255;        // Regex: (while)|(if)|(else)
+    static constexpr int ID_If = 255;               // Keyword: if
+    static constexpr int ID_While = 256;            // Keyword: while
+    static constexpr int ID_Else = 257;             // Keyword: else
   
     // Return the name of a token given its ID.
     static constexpr const char * TokenName(int id) {
@@ -165,7 +171,9 @@ namespace emplex {
       case 252: return "Print";
       case 253: return "Endscope";
       case 254: return "StartScope";
-      case 255: return "Statement";
+      case 255: return "If";
+      case 256: return "While";
+      case 257: return "Else";
       default: return "_ASCII_";
       };
     }
@@ -181,13 +189,56 @@ namespace emplex {
       };
     }
   
+    // Keyword ID for an identifier, or ID_VariableName (defined after the class).
+    static constexpr int IdentifierID(std::string_view word);
+
     // Return the number of token types the lexer recognizes.
     static constexpr int GetNumTokens() { return NUM_TOKENS; }
   
+  private:
+    // -- Hot token classes, scanned with direct character tests --
+    static constexpr bool IsLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static constexpr bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool IsWordChar(char c) { return IsLetter(c) || IsDigit(c) || c == '_'; }
+    static constexpr bool IsSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    // Position of the first char at or after pos that is not in the class.
+    template <bool (*IN_CLASS)(char)>
+    static constexpr int Scan(std::string_view in, int pos) {
+      while (pos < std::ssize(in) && IN_CLASS(in[pos])) pos++;
+      return pos;
+    }
+
+    // Build the token for in[start_pos, end_pos) and move past it.
+    Token MakeToken(std::string_view in, int end_pos, int id) {
+      lexeme = in.substr(start_pos, end_pos-start_pos);
+      start_pos = end_pos;
+
+      // Update the line number we are on.
+      const size_t out_line = cur_line;
+      cur_line += static_cast<size_t>(std::count(lexeme.begin(),lexeme.end(),'\n'));
+
+      return { id, lexeme, out_line };
+    }
+
+  public:
     // Generate and return the next token from the input stream.
     Token NextToken(std::string_view in) {
       // If we cannot read in, return an "EOF" token.
       if (start_pos >= std::ssize(in)) return { 0, "", cur_line };
+
+      // Identifiers, keywords, numbers and whitespace skip the DFA table.
+      const char first = in[start_pos];
+      if (IsLetter(first)) {
+        const int end_pos = Scan<IsWordChar>(in, start_pos + 1);
+        return MakeToken(in, end_pos, IdentifierID(in.substr(start_pos, end_pos - start_pos)));
+      }
+      if (IsDigit(first)) {  // Regex: \d+\.?\d*
+        int end_pos = Scan<IsDigit>(in, start_pos + 1);
+        if (end_pos < std::ssize(in) && in[end_pos] == '.') end_pos = Scan<IsDigit>(in, end_pos + 1);
+        return MakeToken(in, end_pos, ID_Value);
+      }
+      if (IsSpace(first)) return MakeToken(in, Scan<IsSpace>(in, start_pos + 1), ID_WhiteSpace);
   
       int cur_pos = start_pos;   // Position in the input that we are actively analyzing
       int best_pos = start_pos;  // Best look-ahead we've found so far
@@ -220,15 +271,8 @@ namespace emplex {
       // If we did not find any options, peel off just one character and use it as id.
       if (best_pos == start_pos) { best_stop=in[start_pos]; best_pos++;}
   
-      lexeme = in.substr(start_pos, best_pos-start_pos);
-      start_pos += std::ssize(lexeme);
-  
-      // Update the line number we are on.
-      const size_t out_line = cur_line;
-      cur_line += static_cast<size_t>(std::count(lexeme.begin(),lexeme.end(),'\n'));
-  
       // Return the token we found.
-      return { best_stop, lexeme, out_line };
+      return MakeToken(in, best_pos, best_stop);
     }
   
     // Convert an input string into a vector of tokens.
@@ -237,10 +281,15 @@ namespace emplex {
       cur_line = 1;  // Start processing at the first line of the input.
       std::vector<Token> out_tokens;
       while (Token token = NextToken(in)) {
+        if (token.id == ID_VariableName) token.atom = interner.Intern(token.lexeme);
         if (!IgnoreToken(token.id)) out_tokens.push_back(token);
       }
       return out_tokens;
     }
+
+    // Names interned by Tokenize, indexed by Token::atom.
+    Interner & GetInterner() { return interner; }
+    const Interner & GetInterner() const { return interner; }
   
     // Convert an input stream to a string, then tokenize.
     std::vector<Token> Tokenize(std::istream & is) {
@@ -249,5 +298,37 @@ namespace emplex {
       );
     }
   };
+  // -- Keywords --
+  // Identifiers are scanned without the DFA, then checked against the keywords
+  // using a perfect hash on their first letter and length.
+  struct Keyword { std::string_view name; int id; };
+
+  constexpr size_t KeywordHash(std::string_view word) {
+    return (static_cast<size_t>(word[0]) + 4 * word.size()) % 8;
+  }
+
+  constexpr std::array<Keyword, 8> MakeKeywordTable() {
+    std::array<Keyword, 8> out{};
+    for (Keyword kw : { Keyword{"var", Lexer::ID_Var}, Keyword{"print", Lexer::ID_Print},
+                        Keyword{"if", Lexer::ID_If}, Keyword{"while", Lexer::ID_While},
+                        Keyword{"else", Lexer::ID_Else} }) {
+      out[KeywordHash(kw.name)] = kw;
+    }
+    return out;
+  }
+
+  inline constexpr std::array<Keyword, 8> keyword_table = MakeKeywordTable();
+
+  constexpr int Lexer::IdentifierID(std::string_view word) {
+    const Keyword & kw = keyword_table[KeywordHash(word)];
+    return (kw.name == word) ? kw.id : ID_VariableName;
+  }
+
+  static_assert(Lexer::IdentifierID("var") == Lexer::ID_Var &&
+                Lexer::IdentifierID("print") == Lexer::ID_Print &&
+                Lexer::IdentifierID("if") == Lexer::ID_If &&
+                Lexer::IdentifierID("while") == Lexer::ID_While &&
+                Lexer::IdentifierID("else") == Lexer::ID_Else,
+                "Keyword hash must be collision free");
 } // End of namespace emplex
 #endif // #ifndef EMPLEX_LEXER_HPP_INCLUDE_
@@ -0,0 +1,389 @@
+#!/usr/bin/env python3
+"""Differential fuzzing and performance check for the MacroCalc engines.
+
+Every program is run on each engine (plain interpreter, interpreter without
+subexpression caching, --parallel, and --emit-cpp compiled with -O3).  The
+engines must agree on stdout, ERROR messages and exit code.
+
+Timing uses separate loop-heavy workloads, large enough that process start
+up is noise, each run --repeat times keeping the lowest CPU time.  The
+per-engine totals are compared with a baseline recorded on this machine, and
+an engine that looks slower is measured again before it counts as a
+regression.  Without a baseline (or one recorded with other settings) the
+timing check is skipped.
+
+Usage (from tests/):
+  ./fuzz_engines.py                    # 100 random programs
+  ./fuzz_engines.py --corpus           # also run tests/*.Mc (not those needing FLAGS)
+  ./fuzz_engines.py --programs 500 --seed 7 --engines interp,parallel
+  ./fuzz_engines.py --update-baseline  # record timings as the new baseline
+
+Programs that make the engines disagree are saved in fuzz_failures/.
+"""
+
+import argparse
+import glob
+import json
+import os
+import random
+import resource
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PROJECT = os.path.join(HERE, "..", "Project2")
+CXX_FLAGS = ["-O3", "-DNDEBUG", "-std=c++20"]
+
+
+# === PROGRAM GENERATOR ===
+# Follows the grammar the MacroCalc Parse* functions accept.  Every binary
+# operation is parenthesized, loops are bounded by counters nothing else
+# writes, and exponents are small so values stay finite.
+
+class Generator:
+    def __init__(self, rng, allow_errors=True):
+        self.rng = rng
+        self.allow_errors = allow_errors  # Occasionally divide by zero
+        self.scopes = [[]]    # Names declared in each open scope
+        self.readonly = set() # Loop counters
+        self.next_var = 0
+        self.lines = []
+        self.indent = 0
+
+    def visible(self):
+        return [name for scope in self.scopes for name in scope]
+
+    def writable(self):
+        return [name for name in self.visible() if name not in self.readonly]
+
+    def emit(self, text):
+        self.lines.append("  " * self.indent + text)
+
+    def number(self):
+        if self.rng.random() < 0.3:
+            return f"{self.rng.randint(0, 20)}.{self.rng.randint(0, 99)}"
+        return str(self.rng.randint(0, 20))
+
+    def expr(self, depth=0):
+        names = self.visible()
+        if depth >= 3 or self.rng.random() < 0.3:
+            if names and self.rng.random() < 0.6:
+                return self.rng.choice(names)
+            return self.number()
+        kind = self.rng.random()
+        if kind < 0.1:
+            return f"-({self.expr(depth + 1)})"
+        if kind < 0.15:
+            return f"({self.expr(depth + 1)} ** {self.rng.choice(['2', '3'])})"
+        if kind < 0.25:
+            # Divisor is never zero, unless the program is meant to fail.
+            fail = self.allow_errors and self.rng.random() < 0.03
+            divisor = "(2 - 2)" if fail else f"({self.number()} + 1)"
+            return f"({self.expr(depth + 1)} {self.rng.choice(['/', '%'])} {divisor})"
+        op = self.rng.choice(["+", "-", "*"])
+        return f"({self.expr(depth + 1)} {op} {self.expr(depth + 1)})"
+
+    def condition(self):
+        compare = lambda: f"{self.expr(1)} {self.rng.choice(['==', '!=', '<', '>', '<=', '>='])} {self.expr(1)}"
+        kind = self.rng.random()
+        if kind < 0.2:
+            return f"{compare()} {self.rng.choice(['&&', '||'])} {compare()}"
+        if kind < 0.3:
+            return f"!{self.expr(1)}"
+        return compare()
+
+    def declare(self):
+        name = f"v{self.next_var}"
+        self.next_var += 1
+        self.emit(f"var {name} = {self.expr()};")
+        self.scopes[-1].append(name)
+        return name
+
+    def block(self, depth, count):
+        self.emit("{")
+        self.indent += 1
+        self.scopes.append([])
+        for _ in range(count):
+            self.statement(depth + 1)
+        self.scopes.pop()
+        self.indent -= 1
+        self.emit("}")
+
+    def statement(self, depth=0):
+        kind = self.rng.random()
+        names = self.writable()
+        if kind < 0.25 or not self.visible():
+            self.declare()
+        elif kind < 0.4 and names:
+            self.emit(f"{self.rng.choice(names)} = {self.expr()};")
+        elif kind < 0.55:
+            self.emit(f"print({self.expr()});")
+        elif kind < 0.65:
+            shown = self.rng.sample(self.visible(), min(2, len(self.visible())))
+            text = " and ".join(f"{name}={{{name}}}" for name in shown)
+            self.emit(f'print("values: {text}");')
+        elif kind < 0.75 and depth < 3:
+            self.emit(f"if ({self.condition()})")
+            self.block(depth, self.rng.randint(1, 3))
+            if self.rng.random() < 0.5:
+                self.emit("else")
+                self.block(depth, self.rng.randint(1, 3))
+        elif kind < 0.85 and depth < 2:
+            counter = self.declare()
+            self.readonly.add(counter)
+            self.emit(f"{counter} = 0;")
+            self.emit(f"while ({counter} < {self.rng.randint(1, 5)})")
+            self.emit("{")
+            self.indent += 1
+            self.scopes.append([])
+            for _ in range(self.rng.randint(1, 3)):
+                self.statement(depth + 1)
+            self.emit(f"{counter} = {counter} + 1;")
+            self.scopes.pop()
+            self.indent -= 1
+            self.emit("}")
+        elif depth < 3:
+            self.block(depth, self.rng.randint(1, 3))
+        else:
+            self.emit(f"print({self.expr()});")
+
+    def wide_run(self):
+        # Independent declarations, long enough for --parallel to batch them.
+        inputs = self.visible()
+        for _ in range(self.rng.randint(16, 24)):
+            name = f"v{self.next_var}"
+            self.next_var += 1
+            terms = [self.number()] + self.rng.sample(inputs, min(2, len(inputs)))
+            self.emit(f"var {name} = ({' + '.join(terms)}) * {self.number()};")
+            self.scopes[-1].append(name)
+
+    def program(self):
+        for _ in range(self.rng.randint(3, 25)):
+            if self.rng.random() < 0.1:
+                self.wide_run()
+            else:
+                self.statement()
+        self.emit(f"print({self.expr()});")
+        return "\n".join(self.lines) + "\n"
+
+    def workload(self, iterations):
+        # One long loop updating a few accumulators, kept small with '%'.
+        accumulators = [self.declare() for _ in range(4)]
+        self.emit("var i = 0;")
+        self.scopes[-1].append("i")
+        self.readonly.add("i")
+        self.emit(f"while (i < {iterations}) {{")
+        self.indent += 1
+        for _ in range(6):
+            self.emit(f"{self.rng.choice(accumulators)} = ({self.expr()}) % 1000;")
+        self.emit("i = i + 1;")
+        self.indent -= 1
+        self.emit("}")
+        # Then a long run of independent declarations for --parallel.
+        for _ in range(200):
+            self.wide_run()
+        for name in accumulators:
+            self.emit(f"print({name});")
+        return "\n".join(self.lines) + "\n"
+
+
+# === ENGINES ===
+# Each engine prepares a program once and returns the command that runs it,
+# or the result directly if the program was rejected up front.
+
+WORKLOAD_ITERATIONS = 100000
+
+
+def cpu_seconds():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def run(cmd, timeout):
+    """Run cmd; returns its result and the CPU time it used, which is steadier
+    than wall time when other jobs share the machine."""
+    start = cpu_seconds()
+    try:
+        proc = subprocess.run(cmd, capture_output=True, text=True, timeout=timeout)
+        # Only the error messages; the interpreter's trace dump has no native equivalent.
+        errors = "\n".join(line for line in proc.stderr.splitlines() if line.startswith("ERROR"))
+        result = (proc.returncode, (proc.stdout, errors))
+    except subprocess.TimeoutExpired:
+        result = ("timeout", ("", ""))
+    return result, cpu_seconds() - start
+
+
+def interpreter(*flags):
+    def prepare(path, workdir):
+        return [PROJECT, *flags, path], None
+    return prepare
+
+
+def native(path, workdir):
+    base = os.path.join(workdir, os.path.splitext(os.path.basename(path))[0])
+    with open(base + ".cpp", "w") as out:
+        emitted = subprocess.run([PROJECT, "--emit-cpp", path], stdout=out, stderr=subprocess.DEVNULL)
+    if emitted.returncode != 0:
+        return None, (emitted.returncode, None)  # Output not comparable, only the exit code
+    subprocess.run([os.environ.get("CXX", "c++"), *CXX_FLAGS, base + ".cpp", "-o", base], check=True)
+    return [base], None
+
+
+ENGINES = {
+    "interp": interpreter(),
+    "no-cse": interpreter("--no-cse"),
+    "parallel": interpreter("--parallel=4"),
+    "native": native,
+}
+
+
+def run_engines(path, engines, workdir, timeout):
+    """Prepare a program for each engine and run it once.  Returns the results
+    and the commands, so a workload can then be timed without rebuilding."""
+    results, commands = {}, {}
+    for name in engines:
+        cmd, result = ENGINES[name](path, workdir)
+        if cmd is not None:
+            commands[name] = cmd
+            result, _ = run(cmd, timeout)
+        results[name] = result
+    return results, commands
+
+
+def time_workloads(workloads, engines, rounds, timeout, best):
+    """Update best[i][engine] with the lowest CPU time of workload i; returns
+    each engine's total.  Every round runs each workload on each engine in
+    turn, so a busy moment on the machine doesn't land on only one engine."""
+    for _ in range(rounds):
+        for commands, fastest in zip(workloads, best):
+            for name in engines:
+                if name in commands:
+                    _, seconds = run(commands[name], timeout)
+                    fastest[name] = min(seconds, fastest.get(name, seconds))
+    return {name: sum(fastest.get(name, 0.0) for fastest in best) for name in engines}
+
+
+def compare(results):
+    """Return a description of how the engines disagree, or None."""
+    codes = {name: code for name, (code, _) in results.items()}
+    if len(set(code != 0 for code in codes.values())) > 1 or \
+       len(set(code for code in codes.values() if code != 0)) > 1:
+        return f"exit codes differ: {codes}"
+    outputs = {name: out for name, (_, out) in results.items() if out is not None}
+    if len(set(outputs.values())) > 1:
+        return "output differs between " + ", ".join(sorted(outputs))
+    return None
+
+
+def needs_flags(path):
+    with open(path) as f:
+        return f.readline().startswith("// FLAGS:")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--programs", type=int, default=100, help="random programs to generate")
+    parser.add_argument("--seed", type=int, default=450)
+    parser.add_argument("--corpus", action="store_true", help="also run tests/*.Mc")
+    parser.add_argument("--engines", default=",".join(ENGINES), help="comma separated subset of " + ",".join(ENGINES))
+    parser.add_argument("--timeout", type=float, default=10.0, help="seconds per run")
+    parser.add_argument("--workloads", type=int, default=4, help="loop-heavy programs to time (0 skips timing)")
+    parser.add_argument("--repeat", type=int, default=5, help="runs per workload; the fastest is timed")
+    parser.add_argument("--baseline", default=os.path.join(HERE, "perf_baseline.json"))
+    parser.add_argument("--max-regression", type=float, default=10.0, help="allowed slowdown in percent")
+    parser.add_argument("--min-delta", type=float, default=0.02, help="slowdowns under this many seconds are noise")
+    parser.add_argument("--update-baseline", action="store_true")
+    args = parser.parse_args()
+
+    engines = args.engines.split(",")
+    for name in engines:
+        if name not in ENGINES:
+            parser.error(f"unknown engine '{name}'")
+
+    workdir = tempfile.mkdtemp(prefix="macrocalc-fuzz-")
+    rng = random.Random(args.seed)
+    programs = []
+    if args.corpus:
+        # Tests that need command-line limits would just run until the timeout.
+        programs += [path for path in sorted(glob.glob(os.path.join(HERE, "test-*.Mc"))) if not needs_flags(path)]
+    for i in range(args.programs):
+        path = os.path.join(workdir, f"fuzz-{i:04}.Mc")
+        with open(path, "w") as out:
+            out.write(Generator(rng).program())
+        programs.append(path)
+    workloads = []
+    for i in range(args.workloads):
+        path = os.path.join(workdir, f"workload-{i:02}.Mc")
+        with open(path, "w") as out:
+            out.write(Generator(rng, allow_errors=False).workload(WORKLOAD_ITERATIONS))
+        workloads.append(path)
+
+    failures = 0
+    workload_commands = []
+    for path in programs + workloads:
+        results, commands = run_engines(path, engines, workdir, args.timeout)
+        problem = compare(results)
+        if problem:
+            failures += 1
+            os.makedirs(os.path.join(HERE, "fuzz_failures"), exist_ok=True)
+            saved = os.path.join(HERE, "fuzz_failures", os.path.basename(path))
+            shutil.copy(path, saved)
+            print(f"MISMATCH {saved}: {problem}")
+        elif path in workloads:
+            workload_commands.append(commands)
+
+    print(f"Ran {len(programs) + len(workloads)} programs on {len(engines)} engines; {failures} mismatches.")
+    if failures or not workload_commands:
+        shutil.rmtree(workdir)
+        return 1 if failures else 0
+
+    # Timings only compare if the same workloads were run the same way.
+    config = {"seed": args.seed, "programs": args.programs, "workloads": args.workloads,
+              "iterations": WORKLOAD_ITERATIONS, "repeat": args.repeat}
+    best = [{} for _ in workload_commands]
+    totals = time_workloads(workload_commands, engines, max(1, args.repeat), args.timeout, best)
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump({"config": config, "engines": totals}, f, indent=2)
+        print(f"Baseline written to {args.baseline}")
+        baseline = {}
+    elif not baseline:
+        print(f"Timing check SKIPPED: no baseline at {args.baseline} (record one with --update-baseline)")
+    elif baseline.get("config") != config:
+        print(f"Timing check SKIPPED: baseline was recorded with {baseline.get('config')}")
+        baseline = {}
+    old = baseline.get("engines", {})
+
+    def slowdown(name):
+        if not old.get(name) or totals[name] - old[name] <= args.min_delta:
+            return 0.0
+        return 100.0 * (totals[name] - old[name]) / old[name]
+
+    # Before reporting a regression, measure again to rule out a noisy moment.
+    suspects = [name for name in engines if slowdown(name) > args.max_regression]
+    if suspects:
+        print("Measuring again: " + ", ".join(suspects))
+        totals.update(time_workloads(workload_commands, suspects, max(1, args.repeat), args.timeout, best))
+    shutil.rmtree(workdir)
+
+    regressions = 0
+    for name in engines:
+        line = f"  {name:10} {totals[name]:8.3f}s"
+        if old.get(name):
+            line += f"  (baseline {old[name]:.3f}s, {100.0 * (totals[name] - old[name]) / old[name]:+.1f}%)"
+            if slowdown(name) > args.max_regression:
+                line += "  REGRESSION"
+                regressions += 1
+        print(line)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
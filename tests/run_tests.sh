@@ -3,11 +3,11 @@
 # Initialize a counter for differing files
 pass_count=0
 fail_count=0
-test_count=37
+test_count=41
 
 error_pass_count=0
 error_fail_count=0
-error_test_count=16
+error_test_count=36
 
 # Make sure we have directory current/ to put results in.
 if [ ! -d "$DIR" ]; then
@@ -15,7 +15,8 @@ if [ ! -d "$DIR" ]; then
     mkdir -p current
 fi
 
-# Loop through all the regular test file pairs
+# Loop through all the regular test file pairs.  As with the error tests
+# below, a first line "// FLAGS: ..." gives command-line options.
 for i in $(seq -w 01 $test_count); do
     # Set the file names
     code_file="test-${i}.Mc"
@@ -24,7 +25,8 @@ for i in $(seq -w 01 $test_count); do
 
     # Generate the output file for Project2
     if [[ -f "../Project2" && -f "$code_file" ]]; then
-        ../Project2 "$code_file" > "$out_file"
+        flags=$(sed -n '1s|^// FLAGS: ||p' "$code_file")
+        ../Project2 $flags "$code_file" > "$out_file"
     else
         echo "Executable ../Project2 or code file $code_file does not exist."
         continue
@@ -45,33 +47,91 @@ for i in $(seq -w 01 $test_count); do
     fi
 done
 
-# Loop through all the ERROR test file pairs
+# Loop through all the ERROR test file pairs.  Each must stop with an ERROR
+# (return code 1, not a crash).  If expected/output-error-NN.txt exists, what
+# was printed before stopping must match it; if expected/errors-NN.txt exists,
+# the ERROR lines must match it; if expected/trace-NN.txt exists, the trace
+# dump must match it (read from the --trace=FILE file if FLAGS names one,
+# otherwise from the rest of stderr).  A first line "// FLAGS: ..." gives
+# command-line options (such as limits) to run that test with.
 for i in $(seq -w 01 $error_test_count); do
     # Set the file names
     code_file="test-error-${i}.Mc"
     out_file="current/output-error-${i}.txt"
+    err_file="current/errors-${i}.txt"
+    expected_out="expected/output-error-${i}.txt"
+    expected_err="expected/errors-${i}.txt"
+    trace_file="current/trace-${i}.txt"
+    expected_trace="expected/trace-${i}.txt"
 
     # Generate the output file for Project2
     if [[ -f "../Project2" && -f "$code_file" ]]; then
-        ../Project2 "$code_file" > "$out_file"
+        flags=$(sed -n '1s|^// FLAGS: ||p' "$code_file")
+        trace_path=$(echo "$flags" | sed -n 's|.*--trace=\([^ ]*\).*|\1|p')
+        [ -n "$trace_path" ] && rm -f "$trace_path"
+        timeout 60 ../Project2 $flags "$code_file" > "$out_file" 2> "$err_file.full"
+        return_code=$?
+        grep '^ERROR' "$err_file.full" > "$err_file"
+        if [ -z "$trace_path" ]; then
+            grep -v '^ERROR' "$err_file.full" > "$trace_file"
+        elif [ "$trace_path" != "$trace_file" ]; then
+            cp "$trace_path" "$trace_file" 2> /dev/null || : > "$trace_file"
+            rm -f "$trace_path"
+        fi
+        rm -f "$err_file.full"
     else
         echo "Executable ../Project2 or code file $code_file does not exist."
         continue
     fi
 
-    # Check the return code
-    if [ $? -ne 0 ]; then
+    # Check the return code, then any expected output
+    if [ $return_code -ne 1 ]; then
+        echo "Error test $code_file failed (return code $return_code)."
+        ((error_fail_count++))
+    elif [[ -f "$expected_out" ]] && ! diff -q -b "$expected_out" "$out_file" > /dev/null; then
+        echo "Error test $i ... Failed.  Files $expected_out and $out_file differ."
+        ((error_fail_count++))
+    elif [[ -f "$expected_err" ]] && ! diff -q -b "$expected_err" "$err_file" > /dev/null; then
+        echo "Error test $i ... Failed.  Files $expected_err and $err_file differ."
+        ((error_fail_count++))
+    elif [[ -f "$expected_trace" ]] && ! diff -q "$expected_trace" "$trace_file" > /dev/null; then
+        echo "Error test $i ... Failed.  Files $expected_trace and $trace_file differ."
+        ((error_fail_count++))
+    else
         echo "Error test $i ... Passed!"
         ((error_pass_count++))
+    fi
+done
+
+# Translate some regular tests with --emit-cpp, compile them natively and
+# check that they print the same thing the interpreter should.
+native_pass_count=0
+native_fail_count=0
+native_tests="14 16 19 24 26 34 37 39 40"
+native_test_count=$(echo $native_tests | wc -w)
+
+for i in $native_tests; do
+    native_file="test-${i}.native"
+    expected_file="expected/output-${i}.txt"
+    out_file="current/native-${i}.txt"
+
+    if ! make -s -C .. "tests/$native_file" > /dev/null 2> "$out_file"; then
+        echo "Native test $i ... Failed.  Could not translate or compile test-${i}.Mc."
+        ((native_fail_count++))
+    elif ./"$native_file" > "$out_file" && diff -q -b "$expected_file" "$out_file" > /dev/null; then
+        echo "Native test $i ... Passed!"
+        ((native_pass_count++))
     else
-        echo "Error test $code_file failed (zero return code)."
-        ((error_fail_count++))
+        echo "Native test $i ... Failed.  Files $expected_file and $out_file differ."
+        ((native_fail_count++))
     fi
+    rm -f "$native_file" "$native_file.cpp"
 done
 
 # Report the final count of differing files
 echo "Passed $pass_count of $test_count regular tests (Failed $fail_count)"
 echo "Passed $error_pass_count of $error_test_count error tests (Failed $error_fail_count)"
+echo "Passed $native_pass_count of $native_test_count native tests (Failed $native_fail_count)"
 
-total_fail_count=$((fail_count + error_fail_count))
+total_fail_count=$((fail_count + error_fail_count + native_fail_count))
 exit $total_fail_count